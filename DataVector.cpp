@@ -0,0 +1,53 @@
+#include "DataVector.h"
+#include <cmath>
+
+// --- DataVector Implementation ---
+DataVector::DataVector(size_t dimension) { 
+    v.resize(dimension, 0.0); 
+}
+DataVector::~DataVector() {}
+DataVector::DataVector(const DataVector &other) : v(other.v) {}
+DataVector& DataVector::operator=(const DataVector &other) { 
+    if(this != &other) v = other.v; 
+    return *this; 
+}
+void DataVector::setDimension(size_t dimension) { 
+    v.assign(dimension, 0.0); 
+}
+void DataVector::push_back(double val) { 
+    v.push_back(val); 
+}
+size_t DataVector::size() const { 
+    return v.size(); 
+}
+double& DataVector::operator[](int i) { 
+    return v[i]; 
+}
+const double& DataVector::operator[](int i) const { 
+    return v[i]; 
+}
+double DataVector::norm() const { 
+    double s = 0; 
+    for(double x : v) s += x*x; 
+    return sqrt(s); 
+}
+double DataVector::dist(const DataVector &other) const {
+    double s = 0; 
+    for(size_t i=0; i<v.size(); ++i) s += pow(v[i]-other.v[i], 2);
+    return sqrt(s);
+}
+DataVector DataVector::operator-(const DataVector &other) const {
+    DataVector res(v.size()); 
+    for(size_t i=0; i<v.size(); ++i) res[i] = v[i]-other.v[i];
+    return res;
+}
+double DataVector::operator*(const DataVector &other) const {
+    double res = 0; 
+    for(size_t i=0; i<v.size(); ++i) res += v[i]*other.v[i];
+    return res;
+}
+DataVector DataVector::operator+(const DataVector &other) const {
+    DataVector res(v.size());
+    for(size_t i=0; i<v.size(); ++i) res[i] = v[i]+other.v[i];
+    return res;
+}
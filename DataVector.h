@@ -0,0 +1,27 @@
+#ifndef DATAVECTOR_H
+#define DATAVECTOR_H
+
+#include <vector>
+#include <cstddef>
+
+class DataVector {
+private:
+    std::vector<double> v;
+public:
+    DataVector(size_t dimension = 0);
+    ~DataVector();
+    DataVector(const DataVector &other);
+    DataVector &operator=(const DataVector &other);
+    void setDimension(size_t dimension);
+    DataVector operator+(const DataVector &other) const;
+    DataVector operator-(const DataVector &other) const;
+    double operator*(const DataVector &other) const;
+    double norm() const;
+    double dist(const DataVector &other) const;
+    void push_back(double value);
+    size_t size() const;
+    double &operator[](int index);
+    const double &operator[](int index) const;
+};
+
+#endif
@@ -1,61 +1,13 @@
 #include "HNSW.h"
+#include "Parallel.h"
 #include <fstream>
 #include <sstream>
-
-// --- DataVector Implementation ---
-DataVector::DataVector(size_t dimension) { 
-    v.resize(dimension, 0.0); 
-}
-DataVector::~DataVector() {}
-DataVector::DataVector(const DataVector &other) : v(other.v) {}
-DataVector& DataVector::operator=(const DataVector &other) { 
-    if(this != &other) v = other.v; 
-    return *this; 
-}
-void DataVector::setDimension(size_t dimension) { 
-    v.assign(dimension, 0.0); 
-}
-void DataVector::push_back(double val) { 
-    v.push_back(val); 
-}
-size_t DataVector::size() const { 
-    return v.size(); 
-}
-double& DataVector::operator[](int i) { 
-    return v[i]; 
-}
-const double& DataVector::operator[](int i) const { 
-    return v[i]; 
-}
-double DataVector::norm() const { 
-    double s = 0; 
-    for(double x : v) s += x*x; 
-    return sqrt(s); 
-}
-double DataVector::dist(const DataVector &other) const {
-    double s = 0; 
-    for(size_t i=0; i<v.size(); ++i) s += pow(v[i]-other.v[i], 2);
-    return sqrt(s);
-}
-DataVector DataVector::operator-(const DataVector &other) const {
-    DataVector res(v.size()); 
-    for(size_t i=0; i<v.size(); ++i) res[i] = v[i]-other.v[i];
-    return res;
-}
-double DataVector::operator*(const DataVector &other) const {
-    double res = 0; 
-    for(size_t i=0; i<v.size(); ++i) res += v[i]*other.v[i];
-    return res;
-}
-DataVector DataVector::operator+(const DataVector &other) const {
-    DataVector res(v.size());
-    for(size_t i=0; i<v.size(); ++i) res[i] = v[i]+other.v[i];
-    return res;
-}
+#include <deque>
 
 // --- HNSW Implementation ---
 HNSWGraph::HNSWGraph(int M, float ml_val) 
-    : M(M), maxM(M), maxM0(M*2), ml(ml_val), maxLayer(0), entryPoint(0), rng(42), uniformDist(0.0, 1.0) {
+    : M(M), maxM(M), maxM0(M*2), ml(ml_val), maxLayer(0), entryPoint(0), rng(42), uniformDist(0.0, 1.0),
+      pcaDim(0), pcaSampleSize(10000), rerankOriginal(true), indexProjected(false) {
 }
 
 HNSWGraph::~HNSWGraph() {
@@ -165,7 +117,19 @@ std::vector<int> HNSWGraph::searchLayerGreedy(const DataVector &query, const std
 void HNSWGraph::buildIndex(std::vector<DataVector> &dataset) {
     std::cout << "Building HNSW index with " << dataset.size() << " points..." << std::endl;
     
-    data = dataset;
+    nodes.clear();
+    originalData.clear();
+    // Queries follow the PCA settings in effect here, not later enablePCA() calls
+    indexProjected = pcaDim > 0 && !dataset.empty();
+    if (indexProjected) {
+        // A transform restored with loadPCA() is reused instead of retrained
+        if (suppliedPCA.isLoaded()) pca = suppliedPCA;
+        pca.fitIfNeeded(dataset, pcaDim, pcaSampleSize);
+        data = pca.projectAll(dataset);
+        if (rerankOriginal) originalData = dataset;
+    } else {
+        data = dataset;
+    }
     nodes.resize(dataset.size());
     
     for (size_t i = 0; i < dataset.size(); ++i) {
@@ -182,13 +146,13 @@ void HNSWGraph::buildIndex(std::vector<DataVector> &dataset) {
             
             // Search and insert from top to target layer
             for (int lc = maxLayer; lc > layer; --lc) {
-                auto nearest = searchLayer(dataset[i], searchEps, lc);
+                auto nearest = searchLayer(data[i], searchEps, lc);
                 if (!nearest.empty()) searchEps = {nearest[0]};
             }
             
             // Insert at all layers from layer to 0
             for (int lc = std::min(layer, maxLayer); lc >= 0; --lc) {
-                auto candidates = searchLayerGreedy(dataset[i], searchEps, lc, 200);
+                auto candidates = searchLayerGreedy(data[i], searchEps, lc, 200);
                 
                 // Add bidirectional links
                 int M = (lc == 0) ? maxM0 : maxM;
@@ -221,7 +185,80 @@ void HNSWGraph::buildIndex(std::vector<DataVector> &dataset) {
     std::cout << "HNSW index built successfully!" << std::endl;
 }
 
-std::vector<double> HNSWGraph::searchKNearest(const DataVector &query, int k, int ef) {
+// Reverse Cuthill-McKee over the layer 0 graph: BFS from the entry point,
+// visiting neighbors in order of increasing degree, then reverse the order.
+// Returns order[newId] = oldId.
+std::vector<int> HNSWGraph::cuthillMcKeeOrder() {
+    int n = (int)nodes.size();
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<bool> visited(n, false);
+    
+    auto degreeLess = [this](int a, int b) {
+        return nodes[a].neighbors[0].size() < nodes[b].neighbors[0].size();
+    };
+    
+    // The entry point goes first; disconnected components are picked up in input order
+    std::vector<int> starts = {entryPoint};
+    for (int i = 0; i < n; ++i) starts.push_back(i);
+    
+    for (int start : starts) {
+        if (visited[start]) continue;
+        visited[start] = true;
+        size_t head = order.size();
+        order.push_back(start);
+        
+        while (head < order.size()) {
+            int curr = order[head++];
+            std::vector<int> next;
+            for (int neighbor : nodes[curr].neighbors[0]) {
+                if (!visited[neighbor]) {
+                    visited[neighbor] = true;
+                    next.push_back(neighbor);
+                }
+            }
+            std::sort(next.begin(), next.end(), degreeLess);
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+void HNSWGraph::reorderNodes() {
+    if (nodes.empty()) return;
+    
+    std::vector<int> order = cuthillMcKeeOrder();
+    std::vector<int> newId(order.size());
+    for (size_t i = 0; i < order.size(); ++i) newId[order[i]] = (int)i;
+    
+    // Vectors are copied (not swapped) in the new order so their buffers are
+    // also allocated in traversal order, not just the handles in `data`.
+    std::vector<Node> newNodes(nodes.size());
+    std::vector<DataVector> newData(data.size());
+    std::vector<DataVector> newOriginalData(originalData.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        Node &node = newNodes[i];
+        node = nodes[order[i]];
+        for (auto &layerNeighbors : node.neighbors) {
+            for (int &neighbor : layerNeighbors) neighbor = newId[neighbor];
+        }
+        newData[i] = data[order[i]];
+        if (!originalData.empty()) newOriginalData[i] = originalData[order[i]];
+    }
+    
+    nodes.swap(newNodes);
+    data.swap(newData);
+    originalData.swap(newOriginalData);
+    entryPoint = newId[entryPoint];
+}
+
+int HNSWGraph::getExternalId(int internalId) const {
+    return nodes[internalId].id;
+}
+
+std::vector<int> HNSWGraph::descendToLayer0(const DataVector &query) {
     std::vector<int> searchEps = {entryPoint};
     
     // Search from top layer to layer 0
@@ -230,13 +267,271 @@ std::vector<double> HNSWGraph::searchKNearest(const DataVector &query, int k, in
         if (!nearest.empty()) searchEps = {nearest[0]};
     }
     
+    return searchEps;
+}
+
+DataVector HNSWGraph::toIndexSpace(const DataVector &query) const {
+    return indexProjected ? pca.project(query) : query;
+}
+
+// Distances of the k best candidates. With PCA re-ranking, every candidate is
+// rescored against the original vectors and the k closest are kept.
+std::vector<double> HNSWGraph::finalizeResults(const DataVector &query, const DataVector &indexQuery, const std::vector<int> &candidates, int k) {
+    std::vector<double> results;
+    
+    if (!originalData.empty()) {
+        for (int id : candidates) {
+            results.push_back(query.dist(originalData[id]));
+        }
+        std::sort(results.begin(), results.end());
+        if ((int)results.size() > k) results.resize(k);
+        return results;
+    }
+    
+    for (int i = 0; i < std::min(k, (int)candidates.size()); ++i) {
+        results.push_back(indexQuery.dist(data[candidates[i]]));
+    }
+    
+    return results;
+}
+
+// Takes effect at the next buildIndex; the current index keeps the settings it was built with
+void HNSWGraph::enablePCA(int targetDim, bool rerank, size_t sampleSize) {
+    pcaDim = targetDim;
+    rerankOriginal = rerank;
+    pcaSampleSize = sampleSize;
+}
+
+const PCA &HNSWGraph::getPCA() const {
+    return pca;
+}
+
+// Stages a saved transform for the next buildIndex; the current index keeps its projection
+bool HNSWGraph::loadPCA(std::istream &in) {
+    PCA loaded;
+    if (!loaded.load(in)) return false;
+    suppliedPCA = loaded;
+    return true;
+}
+
+std::vector<double> HNSWGraph::searchKNearest(const DataVector &query, int k, int ef) {
+    DataVector indexQuery = toIndexSpace(query);
+    std::vector<int> searchEps = descendToLayer0(indexQuery);
+    
     // Final search at layer 0
-    auto candidates = searchLayerGreedy(query, searchEps, 0, std::max(ef, k));
+    auto candidates = searchLayerGreedy(indexQuery, searchEps, 0, std::max(ef, k));
+    
+    return finalizeResults(query, indexQuery, candidates, k);
+}
+
+// Best-first search at layer 0 that stops as soon as the top-k settles instead
+// of exhausting a fixed ef. Recall is estimated from how many top-k insertions
+// happened over the last `patience` expansions: 1 - insertions / k.
+// Returns the whole candidate list as (distance, id) in ascending distance order.
+std::vector<std::pair<double, int>> HNSWGraph::searchLayerAdaptive(const DataVector &query, const std::vector<int> &entryPoints, int k, const AdaptiveSearchParams &params) {
+    if (k <= 0) return std::vector<std::pair<double, int>>();
+    int ef = std::max(params.maxEf, k);
+    int patience = std::max(params.patience, 1);
+    std::unordered_set<int> visited;
+    std::priority_queue<std::pair<double, int>> candidates;  // max heap on -distance
+    std::priority_queue<std::pair<double, int>> nearest;     // max heap, worst of ef on top
+    std::priority_queue<double> topK;                        // max heap, k-th best on top
+    std::deque<int> window;                                  // top-k insertions per recent expansion
+    int windowInsertions = 0;
+    int stableSteps = 0;
+    int distanceComputations = 0;
+    
+    auto offer = [&](int id, double d) {
+        nearest.push({d, id});
+        if ((int)nearest.size() > ef) nearest.pop();
+        if ((int)topK.size() < k || d < topK.top()) {
+            topK.push(d);
+            if ((int)topK.size() > k) topK.pop();
+            return true;
+        }
+        return false;
+    };
     
+    for (int ep : entryPoints) {
+        if (!visited.insert(ep).second) continue;
+        double d = query.dist(data[ep]);
+        ++distanceComputations;
+        candidates.push({-d, ep});
+        offer(ep, d);
+    }
+    
+    while (!candidates.empty() && distanceComputations < params.maxDistanceComputations) {
+        double currDist = -candidates.top().first;
+        if ((int)nearest.size() >= ef && currDist > nearest.top().first) break;
+        
+        int curr = candidates.top().second;
+        candidates.pop();
+        
+        int insertions = 0;
+        for (int neighbor : nodes[curr].neighbors[0]) {
+            if (distanceComputations >= params.maxDistanceComputations) break;
+            if (!visited.insert(neighbor).second) continue;
+            
+            double d = query.dist(data[neighbor]);
+            ++distanceComputations;
+            if ((int)nearest.size() < ef || d < nearest.top().first) {
+                candidates.push({-d, neighbor});
+                if (offer(neighbor, d)) ++insertions;
+            }
+        }
+        
+        stableSteps = (insertions == 0) ? stableSteps + 1 : 0;
+        if (stableSteps >= patience) break;
+        
+        window.push_back(insertions);
+        windowInsertions += insertions;
+        if ((int)window.size() > patience) {
+            windowInsertions -= window.front();
+            window.pop_front();
+        }
+        if ((int)window.size() == patience && 1.0 - (double)windowInsertions / k >= params.targetRecall) break;
+    }
+    
+    std::vector<std::pair<double, int>> result(nearest.size());
+    for (int i = (int)nearest.size() - 1; i >= 0; --i) {
+        result[i] = nearest.top();
+        nearest.pop();
+    }
+    
+    return result;
+}
+
+std::vector<double> HNSWGraph::searchKNearestAdaptive(const DataVector &query, int k, const AdaptiveSearchParams &params) {
+    if (k <= 0 || nodes.empty()) return std::vector<double>();
+    
+    DataVector indexQuery = toIndexSpace(query);
+    std::vector<int> searchEps = descendToLayer0(indexQuery);
+    auto candidates = searchLayerAdaptive(indexQuery, searchEps, k, params);
+    
+    // Without re-ranking the search's own distances are the answer
+    if (originalData.empty()) {
+        std::vector<double> results;
+        for (int i = 0; i < std::min(k, (int)candidates.size()); ++i) {
+            results.push_back(candidates[i].first);
+        }
+        return results;
+    }
+    
+    std::vector<int> ids;
+    for (auto &candidate : candidates) ids.push_back(candidate.second);
+    return finalizeResults(query, indexQuery, ids, k);
+}
+
+// Flood fill from the entry points through every node within `radius`,
+// returning (distance, id) for each hit. Entry points outside the radius are
+// not reported, but their neighbors are still expanded as starting points.
+std::vector<std::pair<double, int>> HNSWGraph::searchLayerRadius(const DataVector &query, const std::vector<int> &entryPoints, double radius) {
+    std::vector<std::pair<double, int>> result;
+    std::unordered_set<int> visited;
+    std::queue<int> frontier;
+    
+    for (int ep : entryPoints) visited.insert(ep);
+    for (int ep : entryPoints) {
+        double d = query.dist(data[ep]);
+        if (d <= radius) result.push_back({d, ep});
+        for (int neighbor : nodes[ep].neighbors[0]) {
+            if (visited.insert(neighbor).second) frontier.push(neighbor);
+        }
+    }
+    
+    while (!frontier.empty()) {
+        int curr = frontier.front();
+        frontier.pop();
+        double d = query.dist(data[curr]);
+        if (d > radius) continue;
+        result.push_back({d, curr});
+        
+        for (int neighbor : nodes[curr].neighbors[0]) {
+            if (visited.insert(neighbor).second) frontier.push(neighbor);
+        }
+    }
+    
+    return result;
+}
+
+std::vector<double> HNSWGraph::searchRadius(const DataVector &query, double radius, int ef) {
+    if (nodes.empty()) return std::vector<double>();
+    
+    DataVector indexQuery = toIndexSpace(query);
+    std::vector<int> searchEps = descendToLayer0(indexQuery);
+    
+    // Reach the query's neighborhood first, then expand within the radius
+    auto seeds = searchLayerGreedy(indexQuery, searchEps, 0, ef);
+    auto inside = searchLayerRadius(indexQuery, seeds, radius);
+    
+    // Projected distances never exceed original ones, so with re-ranking the
+    // projected hits are a superset that is filtered in the original space
     std::vector<double> results;
-    for (int i = 0; i < std::min(k, (int)candidates.size()); ++i) {
-        results.push_back(query.dist(data[candidates[i]]));
+    bool rerank = !originalData.empty();
+    for (auto &hit : inside) {
+        double d = rerank ? query.dist(originalData[hit.second]) : hit.first;
+        if (d <= radius) results.push_back(d);
     }
+    std::sort(results.begin(), results.end());
     
     return results;
+}
+
+double HNSWGraph::nodeDistance(int a, int b) const {
+    if (!originalData.empty()) {
+        return originalData[a].dist(originalData[b]);
+    }
+    return data[a].dist(data[b]);
+}
+
+// All-points k-NN graph, indexed by external id. Work is split by parallelFor
+// into one contiguous range of nodes per thread (on a reordered index those
+// nodes are also close in memory); there is no other batching. Each point is
+// searched from its own node, with no upper-layer descent, and the search
+// distances are reused as edge weights (only re-ranking recomputes them).
+// Every found edge is then offered to the other endpoint as well, which fills
+// in neighbors the per-point search missed without extra distance computations.
+std::vector<std::vector<std::pair<double, int>>> HNSWGraph::buildKnnGraph(int k, const AdaptiveSearchParams &params, int numThreads) {
+    int n = (int)nodes.size();
+    if (k <= 0) return std::vector<std::vector<std::pair<double, int>>>(n);
+    std::vector<std::vector<std::pair<double, int>>> lists(n);
+    bool rerank = !originalData.empty();
+    
+    parallelFor(n, numThreads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            std::vector<int> searchEps = {(int)i};
+            auto candidates = searchLayerAdaptive(data[i], searchEps, k + 1, params);
+            
+            auto &list = lists[i];
+            for (auto &candidate : candidates) {
+                if (candidate.second == (int)i) continue;
+                double d = rerank ? nodeDistance((int)i, candidate.second) : candidate.first;
+                list.push_back({d, candidate.second});
+            }
+            if (rerank) std::sort(list.begin(), list.end());
+            if ((int)list.size() > k) list.resize(k);
+        }
+    });
+    
+    // Symmetric pass: i -> j implies j -> i at the same distance
+    std::vector<std::vector<std::pair<double, int>>> reverse(n);
+    for (int i = 0; i < n; ++i) {
+        for (auto &edge : lists[i]) reverse[edge.second].push_back({edge.first, i});
+    }
+    
+    std::vector<std::vector<std::pair<double, int>>> graph(n);
+    parallelFor(n, numThreads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            auto merged = lists[i];
+            merged.insert(merged.end(), reverse[i].begin(), reverse[i].end());
+            std::sort(merged.begin(), merged.end());
+            merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+            if ((int)merged.size() > k) merged.resize(k);
+            
+            auto &out = graph[getExternalId((int)i)];
+            for (auto &edge : merged) out.push_back({edge.first, getExternalId(edge.second)});
+        }
+    });
+    
+    return graph;
 }
\ No newline at end of file
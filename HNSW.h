@@ -10,31 +10,24 @@
 #include <algorithm>
 #include <limits>
 #include <iostream>
+#include "DataVector.h"
+#include "PCA.h"
 
-class DataVector {
-private:
-    std::vector<double> v;
-public:
-    DataVector(size_t dimension = 0);
-    ~DataVector();
-    DataVector(const DataVector &other);
-    DataVector &operator=(const DataVector &other);
-    void setDimension(size_t dimension);
-    DataVector operator+(const DataVector &other) const;
-    DataVector operator-(const DataVector &other) const;
-    double operator*(const DataVector &other) const;
-    double norm() const;
-    double dist(const DataVector &other) const;
-    void push_back(double value);
-    size_t size() const;
-    double &operator[](int index);
-    const double &operator[](int index) const;
+// Early-termination settings for HNSWGraph::searchKNearestAdaptive
+struct AdaptiveSearchParams {
+    int patience;                  // Stop after this many layer 0 expansions without a top-k change (at least 1)
+    double targetRecall;           // Stop once the estimated recall reaches this (1.0 = patience only)
+    int maxDistanceComputations;   // Hard cap on distance evaluations at layer 0
+    int maxEf;                     // Upper bound on the candidate list size
+
+    AdaptiveSearchParams(int patience = 10, double targetRecall = 1.0, int maxDistanceComputations = 5000, int maxEf = 200)
+        : patience(patience), targetRecall(targetRecall), maxDistanceComputations(maxDistanceComputations), maxEf(maxEf) {}
 };
 
 class HNSWGraph {
 private:
     struct Node {
-        int id;
+        int id;                                   // External id (position in the input dataset)
         std::vector<std::vector<int>> neighbors;  // neighbors[layer] = list of neighbor ids
         int maxLayer;
     };
@@ -49,18 +42,40 @@ private:
     int entryPoint;          // Entry point for search
     std::mt19937 rng;
     std::uniform_real_distribution<float> uniformDist;
+    PCA pca;                 // Transform the current index was built with
+    PCA suppliedPCA;         // Restored by loadPCA(), used from the next buildIndex on
+    int pcaDim;              // Projected dimension, 0 = PCA disabled
+    size_t pcaSampleSize;    // Vectors sampled to train the projection
+    bool rerankOriginal;     // Re-rank candidates with distances in the original space
+    bool indexProjected;     // Whether the current index was built on projected vectors
+    std::vector<DataVector> originalData;  // Unprojected vectors, kept for re-ranking (empty = no re-rank)
     
     int getRandomLayer();
     std::vector<int> searchLayer(const DataVector &query, const std::vector<int> &entryPoints, int layer);
     std::vector<int> searchLayerGreedy(const DataVector &query, const std::vector<int> &entryPoints, int layer, int ef);
+    std::vector<std::pair<double, int>> searchLayerAdaptive(const DataVector &query, const std::vector<int> &entryPoints, int k, const AdaptiveSearchParams &params);
+    std::vector<std::pair<double, int>> searchLayerRadius(const DataVector &query, const std::vector<int> &entryPoints, double radius);
+    std::vector<int> descendToLayer0(const DataVector &query);
+    DataVector toIndexSpace(const DataVector &query) const;
+    std::vector<double> finalizeResults(const DataVector &query, const DataVector &indexQuery, const std::vector<int> &candidates, int k);
+    double nodeDistance(int a, int b) const;
     void insertNode(const DataVector &data, int label, int layer);
+    std::vector<int> cuthillMcKeeOrder();
     
 public:
     HNSWGraph(int M = 16, float ml = 1.0 / log(2.0));
     ~HNSWGraph();
     
+    void enablePCA(int targetDim, bool rerank = true, size_t sampleSize = 10000);
+    const PCA &getPCA() const;
+    bool loadPCA(std::istream &in);
     void buildIndex(std::vector<DataVector> &dataset);
+    void reorderNodes();
+    int getExternalId(int internalId) const;
     std::vector<double> searchKNearest(const DataVector &query, int k, int ef = 200);
+    std::vector<double> searchKNearestAdaptive(const DataVector &query, int k, const AdaptiveSearchParams &params = AdaptiveSearchParams());
+    std::vector<double> searchRadius(const DataVector &query, double radius, int ef = 200);
+    std::vector<std::vector<std::pair<double, int>>> buildKnnGraph(int k, const AdaptiveSearchParams &params = AdaptiveSearchParams(), int numThreads = 0);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "PCA.h"
+#include "Parallel.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+PCA::PCA() : inDim(0), outDim(0), loaded(false) {}
+
+bool PCA::isFitted() const {
+    return outDim > 0;
+}
+
+bool PCA::isLoaded() const {
+    return loaded;
+}
+
+int PCA::inputDim() const {
+    return inDim;
+}
+
+int PCA::outputDim() const {
+    return outDim;
+}
+
+void PCA::fit(const std::vector<DataVector> &dataset, int targetDim, size_t sampleSize, int numThreads) {
+    if (dataset.empty() || targetDim <= 0) return;
+    
+    loaded = false;
+    inDim = (int)dataset[0].size();
+    outDim = std::min(targetDim, inDim);
+    int d = inDim;
+    
+    // Train on a fixed-seed random sample for reproducible projections
+    std::vector<size_t> sample(dataset.size());
+    for (size_t i = 0; i < sample.size(); ++i) sample[i] = i;
+    if (sampleSize > 0 && sampleSize < sample.size()) {
+        std::mt19937 gen(42);
+        for (size_t i = 0; i < sampleSize; ++i) {
+            std::uniform_int_distribution<size_t> pick(i, sample.size() - 1);
+            std::swap(sample[i], sample[pick(gen)]);
+        }
+        sample.resize(sampleSize);
+    }
+    size_t m = sample.size();
+    std::cout << "Training PCA " << d << " -> " << outDim << " on " << m << " samples..." << std::endl;
+    
+    // Mean
+    int maxThreads = numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::vector<double>> partialSums(maxThreads, std::vector<double>(d, 0.0));
+    int used = parallelFor(m, numThreads, [&](size_t begin, size_t end, int t) {
+        std::vector<double> &sum = partialSums[t];
+        for (size_t s = begin; s < end; ++s) {
+            const DataVector &x = dataset[sample[s]];
+            for (int j = 0; j < d; ++j) sum[j] += x[j];
+        }
+    });
+    mean.assign(d, 0.0);
+    for (int t = 0; t < used; ++t) {
+        for (int j = 0; j < d; ++j) mean[j] += partialSums[t][j];
+    }
+    for (int j = 0; j < d; ++j) mean[j] /= m;
+    partialSums.clear();
+    
+    // Covariance: each thread accumulates the upper triangle over its share of the sample
+    std::vector<std::vector<double>> partialCov(maxThreads);
+    used = parallelFor(m, numThreads, [&](size_t begin, size_t end, int t) {
+        std::vector<double> &cov = partialCov[t];
+        cov.assign((size_t)d * d, 0.0);
+        std::vector<double> x(d);
+        for (size_t s = begin; s < end; ++s) {
+            const DataVector &row = dataset[sample[s]];
+            for (int j = 0; j < d; ++j) x[j] = row[j] - mean[j];
+            for (int i = 0; i < d; ++i) {
+                double xi = x[i];
+                if (xi == 0.0) continue;
+                double *covRow = &cov[(size_t)i * d];
+                for (int j = i; j < d; ++j) covRow[j] += xi * x[j];
+            }
+        }
+    });
+    std::vector<double> cov((size_t)d * d, 0.0);
+    for (int t = 0; t < used; ++t) {
+        for (size_t idx = 0; idx < cov.size(); ++idx) cov[idx] += partialCov[t][idx];
+    }
+    partialCov.clear();
+    double norm = m > 1 ? 1.0 / (m - 1) : 1.0;
+    for (int i = 0; i < d; ++i) {
+        for (int j = i; j < d; ++j) {
+            cov[(size_t)i * d + j] *= norm;
+            cov[(size_t)j * d + i] = cov[(size_t)i * d + j];
+        }
+    }
+    
+    computeComponents(cov, numThreads);
+}
+
+// Top outDim eigenvectors of the covariance matrix by orthogonal (subspace) iteration
+void PCA::computeComponents(const std::vector<double> &cov, int numThreads) {
+    int d = inDim;
+    std::mt19937 gen(42);
+    std::normal_distribution<double> dist(0, 1);
+    
+    auto randomRow = [&](double *row) {
+        for (int j = 0; j < d; ++j) row[j] = dist(gen);
+    };
+    
+    // Modified Gram-Schmidt on the rows of q; rows that collapse (rank-deficient data) are re-seeded
+    auto orthonormalize = [&](std::vector<double> &q) {
+        for (int r = 0; r < outDim; ++r) {
+            double *row = &q[(size_t)r * d];
+            for (int attempt = 0; attempt < 3; ++attempt) {
+                for (int p = 0; p < r; ++p) {
+                    const double *prev = &q[(size_t)p * d];
+                    double dot = 0;
+                    for (int j = 0; j < d; ++j) dot += row[j] * prev[j];
+                    for (int j = 0; j < d; ++j) row[j] -= dot * prev[j];
+                }
+                double len = 0;
+                for (int j = 0; j < d; ++j) len += row[j] * row[j];
+                len = sqrt(len);
+                if (len > 1e-10) {
+                    for (int j = 0; j < d; ++j) row[j] /= len;
+                    break;
+                }
+                randomRow(row);
+            }
+        }
+    };
+    
+    std::vector<double> q((size_t)outDim * d);
+    randomRow(q.data());
+    for (int r = 1; r < outDim; ++r) randomRow(&q[(size_t)r * d]);
+    orthonormalize(q);
+    
+    std::vector<double> z(q.size());
+    const int maxIterations = 300;
+    for (int iter = 0; iter < maxIterations; ++iter) {
+        parallelFor(outDim, numThreads, [&](size_t begin, size_t end, int) {
+            for (size_t r = begin; r < end; ++r) {
+                const double *in = &q[r * d];
+                double *out = &z[r * d];
+                for (int i = 0; i < d; ++i) {
+                    const double *covRow = &cov[(size_t)i * d];
+                    double s = 0;
+                    for (int j = 0; j < d; ++j) s += covRow[j] * in[j];
+                    out[i] = s;
+                }
+            }
+        });
+        orthonormalize(z);
+        
+        double minAlignment = 1.0;
+        for (int r = 0; r < outDim; ++r) {
+            double dot = 0;
+            for (int j = 0; j < d; ++j) dot += q[(size_t)r * d + j] * z[(size_t)r * d + j];
+            minAlignment = std::min(minAlignment, std::abs(dot));
+        }
+        q.swap(z);
+        if (minAlignment > 1.0 - 1e-10) break;
+    }
+    
+    components.swap(q);
+}
+
+// Reuses a transform restored with load() when it maps this dataset's dimension to targetDim.
+// A transform trained by an earlier fit() is never reused: each build refits on its own data.
+void PCA::fitIfNeeded(const std::vector<DataVector> &dataset, int targetDim, size_t sampleSize, int numThreads) {
+    if (dataset.empty() || targetDim <= 0) return;
+    int d = (int)dataset[0].size();
+    if (loaded && inDim == d && outDim == std::min(targetDim, d)) return;
+    fit(dataset, targetDim, sampleSize, numThreads);
+}
+
+DataVector PCA::project(const DataVector &vec) const {
+    DataVector res(outDim);
+    for (int r = 0; r < outDim; ++r) {
+        const double *comp = &components[(size_t)r * inDim];
+        double s = 0;
+        for (int j = 0; j < inDim; ++j) s += comp[j] * (vec[j] - mean[j]);
+        res[r] = s;
+    }
+    return res;
+}
+
+std::vector<DataVector> PCA::projectAll(const std::vector<DataVector> &dataset, int numThreads) const {
+    std::vector<DataVector> projected(dataset.size());
+    parallelFor(dataset.size(), numThreads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) projected[i] = project(dataset[i]);
+    });
+    return projected;
+}
+
+// Binary layout: inDim, outDim, mean[inDim], components[outDim * inDim]
+void PCA::save(std::ostream &out) const {
+    out.write(reinterpret_cast<const char*>(&inDim), sizeof(inDim));
+    out.write(reinterpret_cast<const char*>(&outDim), sizeof(outDim));
+    out.write(reinterpret_cast<const char*>(mean.data()), mean.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(components.data()), components.size() * sizeof(double));
+}
+
+bool PCA::load(std::istream &in) {
+    int d = 0, r = 0;
+    in.read(reinterpret_cast<char*>(&d), sizeof(d));
+    in.read(reinterpret_cast<char*>(&r), sizeof(r));
+    if (!in || d <= 0 || r <= 0 || r > d) {
+        std::cerr << "ERROR: Invalid PCA header" << std::endl;
+        return false;
+    }
+    
+    std::vector<double> m(d), c((size_t)r * d);
+    in.read(reinterpret_cast<char*>(m.data()), m.size() * sizeof(double));
+    in.read(reinterpret_cast<char*>(c.data()), c.size() * sizeof(double));
+    if (!in) {
+        std::cerr << "ERROR: Truncated PCA data" << std::endl;
+        return false;
+    }
+    
+    inDim = d;
+    outDim = r;
+    mean.swap(m);
+    components.swap(c);
+    loaded = true;
+    return true;
+}
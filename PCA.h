@@ -0,0 +1,37 @@
+#ifndef PCA_H
+#define PCA_H
+
+#include <vector>
+#include <iosfwd>
+#include <cstddef>
+#include "DataVector.h"
+
+// Principal component projection applied to data and queries ahead of indexing
+class PCA {
+private:
+    int inDim;
+    int outDim;
+    std::vector<double> mean;
+    std::vector<double> components;  // outDim rows of length inDim, orthonormal
+    bool loaded;                     // Restored with load() rather than trained by fit()
+
+    void computeComponents(const std::vector<double> &cov, int numThreads);
+
+public:
+    PCA();
+
+    void fit(const std::vector<DataVector> &dataset, int targetDim, size_t sampleSize = 10000, int numThreads = 0);
+    void fitIfNeeded(const std::vector<DataVector> &dataset, int targetDim, size_t sampleSize = 10000, int numThreads = 0);
+    DataVector project(const DataVector &vec) const;
+    std::vector<DataVector> projectAll(const std::vector<DataVector> &dataset, int numThreads = 0) const;
+
+    bool isFitted() const;
+    bool isLoaded() const;
+    int inputDim() const;
+    int outputDim() const;
+
+    void save(std::ostream &out) const;
+    bool load(std::istream &in);
+};
+
+#endif
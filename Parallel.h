@@ -0,0 +1,27 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstddef>
+
+// Splits [0, n) into contiguous chunks and runs f(begin, end, chunkIndex) on each in its own thread.
+// numThreads <= 0 uses the hardware concurrency. Returns the number of chunks used.
+template <typename Func>
+int parallelFor(size_t n, int numThreads, Func f) {
+    if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = (int)std::max<size_t>(1, std::min<size_t>(numThreads, n));
+    size_t chunk = (n + numThreads - 1) / numThreads;
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+        size_t begin = t * chunk;
+        size_t end = std::min(n, begin + chunk);
+        threads.emplace_back(f, begin, end, t);
+    }
+    for (auto &th : threads) th.join();
+    return numThreads;
+}
+
+#endif
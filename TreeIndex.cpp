@@ -3,55 +3,6 @@
 #include <fstream>
 #include <sstream>
 
-// --- DataVector Implementation ---
-DataVector::DataVector(size_t dimension) { 
-    v.resize(dimension, 0.0); 
-}
-DataVector::~DataVector() {}
-DataVector::DataVector(const DataVector &other) : v(other.v) {}
-DataVector& DataVector::operator=(const DataVector &other) { 
-    if(this != &other) v = other.v; return *this; 
-}
-void DataVector::setDimension(size_t dimension) { 
-    v.assign(dimension, 0.0); 
-}
-void DataVector::push_back(double val) { 
-    v.push_back(val); 
-}
-size_t DataVector::size() const { 
-    return v.size(); 
-}
-double& DataVector::operator[](int i) { 
-    return v[i]; 
-}
-const double& DataVector::operator[](int i) const { 
-    return v[i]; 
-}
-double DataVector::norm() const { 
-    double s = 0; 
-    for(double x : v) s += x*x; 
-    return sqrt(s); 
-}
-double DataVector::dist(const DataVector &other) const {
-    double s = 0; 
-    for(size_t i=0; i<v.size(); ++i) s += pow(v[i]-other.v[i], 2);
-    return sqrt(s);
-}
-DataVector DataVector::operator-(const DataVector &other) const {
-    DataVector res(v.size()); 
-    for(size_t i=0; i<v.size(); ++i) res[i] = v[i]-other.v[i];
-    return res;
-}
-double DataVector::operator*(const DataVector &other) const {
-    double res = 0; for(size_t i=0; i<v.size(); ++i) res += v[i]*other.v[i];
-    return res;
-}
-DataVector DataVector::operator+(const DataVector &other) const {
-    DataVector res(v.size());
-    for(size_t i=0; i<v.size(); ++i) res[i] = v[i]+other.v[i];
-    return res;
-}
-
 // --- VectorDataset Implementation ---
 void VectorDataset::read_dataset(const std::string &filename) {
     std::ifstream file(filename);
@@ -102,40 +53,208 @@ void VectorDataset::read_dataset(const std::string &filename) {
 }
 
 // --- Tree Logic ---
-void TreeIndex::clear(Node* node) {
-    if (!node) return;
-    clear(node->left); 
-    clear(node->right);
-    delete node;
+void TreeIndex::clear() {
+    nodes.clear();
+    leafData.clear();
+    originalLeafData.clear();
+    root = -1;
+}
+
+// Takes effect at the next Maketree; the current tree keeps the settings it was built with
+void TreeIndex::enablePCA(int targetDim, bool rerank, size_t sampleSize) {
+    pcaDim = targetDim;
+    rerankOriginal = rerank;
+    pcaSampleSize = sampleSize;
+}
+
+// Fits the projection (unless a matching one was loaded) and returns the projected copy to build on
+std::vector<DataVector> TreeIndex::projectDataset(const std::vector<DataVector> &dataset) {
+    if (suppliedPCA.isLoaded()) pca = suppliedPCA;
+    pca.fitIfNeeded(dataset, pcaDim, pcaSampleSize);
+    return pca.projectAll(dataset);
+}
+
+// Stages a saved transform for the next Maketree; the current tree keeps its projection
+bool TreeIndex::loadPCA(std::istream &in) {
+    PCA loaded;
+    if (!loaded.load(in)) return false;
+    suppliedPCA = loaded;
+    return true;
+}
+
+DataVector TreeIndex::toIndexSpace(const DataVector &target) const {
+    return indexProjected ? pca.project(target) : target;
+}
+
+static size_t paddedStride(size_t dim) {
+    return std::max<size_t>(8, (dim + 7) / 8 * 8);
+}
+
+// Clears the tree, projects the dataset if PCA is enabled, and sizes leaf storage.
+// Returns the rows to split on: `projected` when projecting, otherwise `dataset`.
+const std::vector<DataVector> &TreeIndex::prepareBuild(const std::vector<DataVector> &dataset, std::vector<DataVector> &projected) {
+    clear();
+    indexProjected = pcaDim > 0 && !dataset.empty();
+    if (indexProjected) projected = projectDataset(dataset);
+    const std::vector<DataVector> &rows = indexProjected ? projected : dataset;
+    
+    leafStride = paddedStride(rows.empty() ? 0 : rows[0].size());
+    leafData.reserve(rows.size() * leafStride);
+    originalStride = 0;
+    if (indexProjected && rerankOriginal) {
+        originalStride = paddedStride(dataset[0].size());
+        originalLeafData.reserve(dataset.size() * originalStride);
+    }
+    nodes.reserve(4 * rows.size() / std::max(leafSize, 1) + 1);
+    return rows;
+}
+
+// Copies the rows with the given ids into leafData as zero-padded rows (and their
+// unprojected versions into originalLeafData when re-ranking); returns the new leaf's index
+int TreeIndex::makeLeaf(std::vector<int>::iterator begin, std::vector<int>::iterator end, const std::vector<DataVector> &rows, const std::vector<DataVector> &originals) {
+    Node n;
+    n.isLeaf = true;
+    n.leafBegin = leafData.size() / leafStride;
+    n.leafCount = (int)std::distance(begin, end);
+    
+    leafData.resize(leafData.size() + n.leafCount * leafStride, 0.0);
+    double *row = leafData.data() + n.leafBegin * leafStride;
+    for (auto it = begin; it != end; ++it, row += leafStride) {
+        const DataVector &v = rows[*it];
+        for (size_t j = 0; j < v.size(); ++j) row[j] = v[j];
+    }
+    
+    if (originalStride > 0) {
+        originalLeafData.resize(originalLeafData.size() + n.leafCount * originalStride, 0.0);
+        double *orig = originalLeafData.data() + n.leafBegin * originalStride;
+        for (auto it = begin; it != end; ++it, orig += originalStride) {
+            const DataVector &v = originals[*it];
+            for (size_t j = 0; j < v.size(); ++j) orig[j] = v[j];
+        }
+    }
+    
+    nodes.push_back(n);
+    return (int)nodes.size() - 1;
+}
+
+TreeIndex::Query TreeIndex::makeQuery(const DataVector &target) const {
+    Query q;
+    q.target = toIndexSpace(target);
+    q.padded.assign(leafStride, 0.0);
+    for (size_t j = 0; j < std::min(leafStride, q.target.size()); ++j) q.padded[j] = q.target[j];
+    if (!originalLeafData.empty()) {
+        q.originalPadded.assign(originalStride, 0.0);
+        for (size_t j = 0; j < std::min(originalStride, target.size()); ++j) q.originalPadded[j] = target[j];
+    }
+    q.dists.resize(std::max(leafSize, 1));
+    return q;
+}
+
+// Squared distance between two padded rows. Rows are padded to a multiple of 8,
+// so the 8 independent accumulators map directly onto vector lanes without
+// needing -ffast-math.
+static double squaredDistance(const double *a, const double *b, size_t stride) {
+    double acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (size_t j = 0; j < stride; j += 8) {
+        for (int l = 0; l < 8; ++l) {
+            double diff = a[j + l] - b[j + l];
+            acc[l] += diff * diff;
+        }
+    }
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+// Distance summed in the same order as DataVector::dist, so it matches that value exactly
+static double sequentialDistance(const double *a, const double *b, size_t stride) {
+    double s = 0;
+    for (size_t j = 0; j < stride; ++j) s += (a[j] - b[j]) * (a[j] - b[j]);
+    return sqrt(s);
+}
+
+// The batched kernel sums in a different order than DataVector::dist, so a point
+// lying exactly on the radius can land an ulp on either side; such points are
+// settled with the sequential sum instead
+static double settleAtRadius(double d, double radius, const double *a, const double *b, size_t stride) {
+    return std::abs(d - radius) <= 1e-9 * radius ? sequentialDistance(a, b, stride) : d;
+}
+
+// Squared distances from the query to every row of the leaf, written to q.dists
+void TreeIndex::scanLeaf(const Node &leaf, Query &q) const {
+    if ((int)q.dists.size() < leaf.leafCount) q.dists.resize(leaf.leafCount);
+    const double *query = q.padded.data();
+    const double *row = leafData.data() + leaf.leafBegin * leafStride;
+    
+    for (int r = 0; r < leaf.leafCount; ++r, row += leafStride) {
+        q.dists[r] = squaredDistance(row, query, leafStride);
+    }
+}
+
+double TreeIndex::originalDistSq(const Node &leaf, int i, const Query &q) const {
+    const double *row = originalLeafData.data() + (leaf.leafBegin + i) * originalStride;
+    return squaredDistance(row, q.originalPadded.data(), originalStride);
+}
+
+// Merges a leaf into best. When re-ranking, best holds original-space distances;
+// a projected distance never exceeds the original one, so only rows whose
+// projected distance beats the current worst need rescoring.
+void TreeIndex::collectLeaf(const Node &leaf, Query &q, TopKBuffer &best) const {
+    scanLeaf(leaf, q);
+    bool rerank = !originalLeafData.empty();
+    for(int i = 0; i < leaf.leafCount; ++i) {
+        if (!rerank) {
+            best.push(q.dists[i]);
+        } else if (q.dists[i] < best.worst()) {
+            best.push(originalDistSq(leaf, i, q));
+        }
+    }
+}
+
+// Appends the leaf's distances within radius. When re-ranking, projected hits
+// (a superset of the true ones) are filtered and reported in the original space.
+void TreeIndex::collectLeafRadius(const Node &leaf, Query &q, double radius, std::vector<double> &res) const {
+    scanLeaf(leaf, q);
+    bool rerank = !originalLeafData.empty();
+    for(int i = 0; i < leaf.leafCount; ++i) {
+        // Compare the same rooted value that is returned, not the squared sum
+        const double *row = leafData.data() + (leaf.leafBegin + i) * leafStride;
+        double d = settleAtRadius(sqrt(q.dists[i]), radius, row, q.padded.data(), leafStride);
+        if(d > radius) continue;
+        if(rerank) {
+            const double *orig = originalLeafData.data() + (leaf.leafBegin + i) * originalStride;
+            d = settleAtRadius(sqrt(originalDistSq(leaf, i, q)), radius, orig, q.originalPadded.data(), originalStride);
+        }
+        if(d <= radius) res.push_back(d);
+    }
 }
 
 // --- KDTreeIndex Implementation ---
 void KDTreeIndex::Maketree(std::vector<DataVector> &dataset) {
-    if (root) clear(root);  // Clear old tree if exists
-    root = build(dataset.begin(), dataset.end());
+    // The tree is built over row ids, so the caller's dataset is left untouched
+    std::vector<DataVector> projected;
+    const std::vector<DataVector> &rows = prepareBuild(dataset, projected);
+    std::vector<int> ids(rows.size());
+    for (size_t i = 0; i < ids.size(); ++i) ids[i] = (int)i;
+    root = build(ids.begin(), ids.end(), rows, dataset);
 }
 
-TreeIndex::Node* KDTreeIndex::build(std::vector<DataVector>::iterator begin, std::vector<DataVector>::iterator end) {
-    if (std::distance(begin, end) <= 100) {
-        Node* n = new Node(); 
-        n->isLeaf = true;
-        n->points.assign(begin, end);
-        return n;
+int KDTreeIndex::build(std::vector<int>::iterator begin, std::vector<int>::iterator end, const std::vector<DataVector> &rows, const std::vector<DataVector> &originals) {
+    if (std::distance(begin, end) <= std::max(leafSize, 1)) {
+        return makeLeaf(begin, end, rows, originals);
     }
     
     // Find dimension with max spread
     int splitDim = 0;
     double maxSpread = -1;
     
-    for(int i=0; i<begin->size(); ++i) {
-        auto res = std::minmax_element(begin, end, [i](const DataVector& a, const DataVector& b) { 
-            return a[i] < b[i]; 
+    for(int i=0; i<(int)rows[*begin].size(); ++i) {
+        auto res = std::minmax_element(begin, end, [i, &rows](int a, int b) { 
+            return rows[a][i] < rows[b][i]; 
         });
 
         auto min_it = res.first;
         auto max_it = res.second;
 
-        double spread = (*max_it)[i] - (*min_it)[i];
+        double spread = rows[*max_it][i] - rows[*min_it][i];
         if(spread > maxSpread) { 
             maxSpread = spread; 
             splitDim = i; 
@@ -143,111 +262,170 @@ TreeIndex::Node* KDTreeIndex::build(std::vector<DataVector>::iterator begin, std
     }
     
     // Sort and split
-    std::sort(begin, end, [splitDim](const DataVector& a, const DataVector& b){ 
-        return a[splitDim] < b[splitDim]; 
+    std::sort(begin, end, [splitDim, &rows](int a, int b){ 
+        return rows[a][splitDim] < rows[b][splitDim]; 
     });
     auto mid = begin + std::distance(begin, end)/2;
     
-    Node* n = new Node();
-    n->splitDim = splitDim;
-    n->splitVal = (*mid)[splitDim];
-    n->left = build(begin, mid);
-    n->right = build(mid, end);
-    return n;
+    int idx = (int)nodes.size();
+    nodes.push_back(Node());
+    nodes[idx].splitDim = splitDim;
+    nodes[idx].splitVal = rows[*mid][splitDim];
+    int left = build(begin, mid, rows, originals);
+    int right = build(mid, end, rows, originals);
+    nodes[idx].left = left;
+    nodes[idx].right = right;
+    return idx;
 }
 
 std::vector<double> KDTreeIndex::searchKNearest(const DataVector &target, int k) {
-    std::priority_queue<double> pq;
-    searchRecursive(root, target, k, pq);
     std::vector<double> res;
-    while(!pq.empty()) { 
-        res.push_back(pq.top()); 
-        pq.pop(); 
+    if (root < 0 || k <= 0) return res;
+    
+    Query q = makeQuery(target);
+    TopKBuffer best(k, pointCount());
+    searchRecursive(root, q, best);
+    for (double d : best.values()) res.push_back(sqrt(d));
+    return res;
+}
+
+// best holds squared distances, so split gaps are compared squared as well
+void KDTreeIndex::searchRecursive(int node, Query &q, TopKBuffer &best) {
+    if (node < 0) return;
+    const Node &n = nodes[node];
+    if (n.isLeaf) {
+        collectLeaf(n, q, best);
+        return;
     }
-    std::reverse(res.begin(), res.end());
+    double gap = q.target[n.splitDim] - n.splitVal;
+    int nearer = (gap <= 0) ? n.left : n.right;
+    int farther = (gap <= 0) ? n.right : n.left;
+
+    searchRecursive(nearer, q, best);
+    if (!best.full() || gap * gap < best.worst()) {
+        searchRecursive(farther, q, best);
+    }
+}
+
+std::vector<double> KDTreeIndex::searchRadius(const DataVector &target, double radius) {
+    std::vector<double> res;
+    if (root < 0) return res;
+    
+    Query q = makeQuery(target);
+    searchRadiusRecursive(root, q, radius, res);
+    std::sort(res.begin(), res.end());
     return res;
 }
 
-void KDTreeIndex::searchRecursive(Node* node, const DataVector &target, int k, std::priority_queue<double> &pq) {
-    if (!node) return;
-    if (node->isLeaf) {
-        for(auto &p : node->points) {
-            double d = target.dist(p);
-            pq.push(d); 
-            if(pq.size()>k) pq.pop();
-        }
+void KDTreeIndex::searchRadiusRecursive(int node, Query &q, double radius, std::vector<double> &res) {
+    if (node < 0) return;
+    const Node &n = nodes[node];
+    if (n.isLeaf) {
+        collectLeafRadius(n, q, radius, res);
         return;
     }
-    Node *nearer = (target[node->splitDim] <= node->splitVal) ? node->left : node->right;
-    Node *farther = (target[node->splitDim] <= node->splitVal) ? node->right : node->left;
+    double gap = q.target[n.splitDim] - n.splitVal;
+    int nearer = (gap <= 0) ? n.left : n.right;
+    int farther = (gap <= 0) ? n.right : n.left;
 
-    searchRecursive(nearer, target, k, pq);
-    if (pq.size() < k || std::abs(target[node->splitDim] - node->splitVal) < pq.top()) {
-        searchRecursive(farther, target, k, pq);
+    searchRadiusRecursive(nearer, q, radius, res);
+    if (std::abs(gap) <= radius) {
+        searchRadiusRecursive(farther, q, radius, res);
     }
 }
 
 // --- RPTreeIndex Implementation ---
 void RPTreeIndex::Maketree(std::vector<DataVector> &dataset) {
-    if (root) clear(root);  // Clear old tree if exists
-    root = build(dataset.begin(), dataset.end());
+    // The tree is built over row ids, so the caller's dataset is left untouched
+    std::vector<DataVector> projected;
+    const std::vector<DataVector> &rows = prepareBuild(dataset, projected);
+    std::vector<int> ids(rows.size());
+    for (size_t i = 0; i < ids.size(); ++i) ids[i] = (int)i;
+    root = build(ids.begin(), ids.end(), rows, dataset);
 }
 
-TreeIndex::Node* RPTreeIndex::build(std::vector<DataVector>::iterator begin, std::vector<DataVector>::iterator end) {
-    if (std::distance(begin, end) <= 100) {
-        Node* n = new Node();
-        n->isLeaf = true;
-        n->points.assign(begin, end);
-        return n;
+int RPTreeIndex::build(std::vector<int>::iterator begin, std::vector<int>::iterator end, const std::vector<DataVector> &rows, const std::vector<DataVector> &originals) {
+    if (std::distance(begin, end) <= std::max(leafSize, 1)) {
+        return makeLeaf(begin, end, rows, originals);
     }
     
     // Random Gaussian Direction
     static std::mt19937 gen(42);
     std::normal_distribution<double> dist(0, 1);
-    DataVector dir(begin->size());
+    DataVector dir(rows[*begin].size());
     for(size_t i=0; i<dir.size(); ++i) dir[i] = dist(gen);
 
-    std::sort(begin, end, [&dir](const DataVector& a, const DataVector& b){ 
-        return (a*dir) < (b*dir);
+    std::sort(begin, end, [&dir, &rows](int a, int b){ 
+        return (rows[a]*dir) < (rows[b]*dir);
     });
     auto mid = begin + std::distance(begin, end)/2;
 
-    Node* n = new Node();
-    n->projDir = dir;
-    n->splitVal = (*mid)*dir;
-    n->left = build(begin, mid);
-    n->right = build(mid, end);
-    return n;
+    int idx = (int)nodes.size();
+    nodes.push_back(Node());
+    nodes[idx].projDir = dir;
+    nodes[idx].projNormSq = dir * dir;
+    nodes[idx].splitVal = rows[*mid]*dir;
+    int left = build(begin, mid, rows, originals);
+    int right = build(mid, end, rows, originals);
+    nodes[idx].left = left;
+    nodes[idx].right = right;
+    return idx;
 }
 
 std::vector<double> RPTreeIndex::searchKNearest(const DataVector &target, int k) {
-    std::priority_queue<double> pq;
-    searchRecursive(root, target, k, pq);
     std::vector<double> res;
-    while(!pq.empty()) { 
-        res.push_back(pq.top()); 
-        pq.pop(); 
+    if (root < 0 || k <= 0) return res;
+    
+    Query q = makeQuery(target);
+    TopKBuffer best(k, pointCount());
+    searchRecursive(root, q, best);
+    for (double d : best.values()) res.push_back(sqrt(d));
+    return res;
+}
+
+// best holds squared distances, so split gaps are compared squared as well
+void RPTreeIndex::searchRecursive(int node, Query &q, TopKBuffer &best) {
+    if (node < 0) return;
+    const Node &n = nodes[node];
+    if (n.isLeaf) {
+        collectLeaf(n, q, best);
+        return;
+    }
+    double gap = q.target * n.projDir - n.splitVal;
+    int nearer = (gap <= 0) ? n.left : n.right;
+    int farther = (gap <= 0) ? n.right : n.left;
+
+    searchRecursive(nearer, q, best);
+    // projDir is not unit length: the plane distance is gap / |projDir|
+    if (!best.full() || gap * gap < best.worst() * n.projNormSq) {
+        searchRecursive(farther, q, best);
     }
-    std::reverse(res.begin(), res.end());
+}
+
+std::vector<double> RPTreeIndex::searchRadius(const DataVector &target, double radius) {
+    std::vector<double> res;
+    if (root < 0) return res;
+    
+    Query q = makeQuery(target);
+    searchRadiusRecursive(root, q, radius, res);
+    std::sort(res.begin(), res.end());
     return res;
 }
 
-void RPTreeIndex::searchRecursive(Node* node, const DataVector &target, int k, std::priority_queue<double> &pq) {
-    if (!node) return;
-    if (node->isLeaf) {
-        for(auto &p : node->points) {
-            double d = target.dist(p);
-            pq.push(d);
-            if(pq.size() > k) pq.pop();
-        }
+void RPTreeIndex::searchRadiusRecursive(int node, Query &q, double radius, std::vector<double> &res) {
+    if (node < 0) return;
+    const Node &n = nodes[node];
+    if (n.isLeaf) {
+        collectLeafRadius(n, q, radius, res);
         return;
     }
-    double proj = target * node->projDir;
-    Node *nearer = (proj <= node->splitVal) ? node->left : node->right;
-    Node *farther = (proj <= node->splitVal) ? node->right : node->left;
+    double gap = q.target * n.projDir - n.splitVal;
+    int nearer = (gap <= 0) ? n.left : n.right;
+    int farther = (gap <= 0) ? n.right : n.left;
 
-    searchRecursive(nearer, target, k, pq);
-    if (pq.size() < k || std::abs(proj - node->splitVal) < pq.top()) {
-        searchRecursive(farther, target, k, pq);
+    searchRadiusRecursive(nearer, q, radius, res);
+    // projDir is not unit length: the plane distance is gap / |projDir|
+    if (gap * gap <= radius * radius * n.projNormSq) {
+        searchRadiusRecursive(farther, q, radius, res);
     }
 }
\ No newline at end of file
@@ -6,26 +6,10 @@
 #include <cmath>
 #include <algorithm>
 #include <random>
-
-class DataVector {
-private:
-    std::vector<double> v;
-public:
-    DataVector(size_t dimension = 0);
-    ~DataVector();
-    DataVector(const DataVector &other);
-    DataVector &operator=(const DataVector &other);
-    void setDimension(size_t dimension);
-    DataVector operator+(const DataVector &other) const;
-    DataVector operator-(const DataVector &other) const;
-    double operator*(const DataVector &other) const;
-    double norm() const;
-    double dist(const DataVector &other) const;
-    void push_back(double value);
-    size_t size() const;
-    double &operator[](int index);
-    const double &operator[](int index) const;
-};
+#include <limits>
+#include <cstdint>
+#include "DataVector.h"
+#include "PCA.h"
 
 class VectorDataset {
 public:
@@ -39,45 +23,147 @@ public:
     }
 };
 
+// Allocator returning Alignment-byte aligned storage, so leaf rows line up with SIMD registers and cache lines
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+    typedef T value_type;
+    template <typename U> struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T* allocate(size_t n) {
+        // Over-allocate, align, and keep the raw pointer just before the aligned block
+        char *raw = static_cast<char*>(::operator new(n * sizeof(T) + Alignment + sizeof(void*)));
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+    void deallocate(T *p, size_t) {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+template <typename T, typename U, size_t A>
+bool operator==(const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) { return true; }
+template <typename T, typename U, size_t A>
+bool operator!=(const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) { return false; }
+
+// Fixed-capacity buffer of the k smallest values seen, kept sorted ascending
+class TopKBuffer {
+private:
+    std::vector<double> vals;
+    int k;
+public:
+    // maxPoints bounds how many values can ever arrive, so memory follows the data, not k
+    TopKBuffer(int k, size_t maxPoints) : k(k) {
+        vals.reserve(std::min<size_t>(k, maxPoints) + 1);
+    }
+    bool full() const {
+        return (int)vals.size() >= k;
+    }
+    double worst() const {
+        return full() ? vals.back() : std::numeric_limits<double>::max();
+    }
+    void push(double v) {
+        if (full() && v >= vals.back()) return;
+        vals.insert(std::upper_bound(vals.begin(), vals.end(), v), v);
+        if ((int)vals.size() > k) vals.pop_back();
+    }
+    const std::vector<double> &values() const {
+        return vals;
+    }
+};
+
 // Base Tree class
 class TreeIndex {
 public:
+    typedef std::vector<double, AlignedAllocator<double, 64>> AlignedBuffer;
+
     struct Node {
-        std::vector<DataVector> points; // For leaves
+        size_t leafBegin;               // For leaves: first row in leafData
+        int leafCount;                  // For leaves: number of rows
         int splitDim;                   // For KD-Tree
         double splitVal;                // Median or Delta
         DataVector projDir;             // For RP-Tree
-        Node *left, *right;
+        double projNormSq;              // For RP-Tree: |projDir|^2, scales projected gaps to plane distances
+        int left, right;                // Indices into nodes, -1 = none
         bool isLeaf;
 
-        Node() : left(nullptr), right(nullptr), isLeaf(false), splitDim(-1), splitVal(0) {}
+        Node() : leafBegin(0), leafCount(0), splitDim(-1), splitVal(0), projNormSq(1), left(-1), right(-1), isLeaf(false) {}
     };
 
-    Node* root;
-    TreeIndex() : root(nullptr) {}
-    virtual ~TreeIndex() { 
-        clear(root);
-    }
-    void clear(Node* node);
+    // Everything a query needs: the target for split tests, padded copies for leaf scans, and scratch space
+    struct Query {
+        DataVector target;
+        AlignedBuffer padded;
+        AlignedBuffer originalPadded;  // Unprojected target, only when re-ranking
+        std::vector<double> dists;
+    };
+
+    std::vector<Node> nodes;  // Flat node array, children referenced by index
+    int root;
+    TreeIndex(int leafSize = 100)
+        : root(-1), leafSize(leafSize), leafStride(0), originalStride(0), pcaDim(0), pcaSampleSize(10000), rerankOriginal(true), indexProjected(false) {}
+    virtual ~TreeIndex() {}
+    void clear();
     virtual void Maketree(std::vector<DataVector> &dataset) = 0;
+    void enablePCA(int targetDim, bool rerank = true, size_t sampleSize = 10000);
+    const PCA &getPCA() const {
+        return pca;
+    }
+    bool loadPCA(std::istream &in);
+
+protected:
+    int leafSize;            // Max points per leaf
+    size_t leafStride;       // Row length in leafData: dimension padded to a multiple of 8 doubles (64 bytes)
+    AlignedBuffer leafData;  // All leaf points, each leaf a contiguous block of rows
+    size_t originalStride;   // Row length in originalLeafData
+    AlignedBuffer originalLeafData;  // Unprojected rows parallel to leafData, kept for re-ranking (empty = no re-rank)
+    PCA pca;                 // Transform the current tree was built with
+    PCA suppliedPCA;         // Restored by loadPCA(), used from the next Maketree on
+    int pcaDim;              // Projected dimension, 0 = PCA disabled
+    size_t pcaSampleSize;    // Vectors sampled to train the projection
+    bool rerankOriginal;     // Re-rank candidates with distances in the original space
+    bool indexProjected;     // Whether the current tree was built on projected vectors
+
+    std::vector<DataVector> projectDataset(const std::vector<DataVector> &dataset);
+    DataVector toIndexSpace(const DataVector &target) const;
+    const std::vector<DataVector> &prepareBuild(const std::vector<DataVector> &dataset, std::vector<DataVector> &projected);
+    int makeLeaf(std::vector<int>::iterator begin, std::vector<int>::iterator end, const std::vector<DataVector> &rows, const std::vector<DataVector> &originals);
+    Query makeQuery(const DataVector &target) const;
+    void scanLeaf(const Node &leaf, Query &q) const;
+    size_t pointCount() const {
+        return leafData.size() / leafStride;
+    }
+    double originalDistSq(const Node &leaf, int i, const Query &q) const;
+    void collectLeaf(const Node &leaf, Query &q, TopKBuffer &best) const;
+    void collectLeafRadius(const Node &leaf, Query &q, double radius, std::vector<double> &res) const;
 };
 
 class KDTreeIndex : public TreeIndex {
     public:
+        explicit KDTreeIndex(int leafSize = 100) : TreeIndex(leafSize) {}
         void Maketree(std::vector<DataVector> &dataset) override;
         std::vector<double> searchKNearest(const DataVector &target, int k);
+        std::vector<double> searchRadius(const DataVector &target, double radius);
     private:
-        Node* build(std::vector<DataVector>::iterator begin, std::vector<DataVector>::iterator end);
-        void searchRecursive(Node* node, const DataVector &target, int k, std::priority_queue<double> &pq);
+        int build(std::vector<int>::iterator begin, std::vector<int>::iterator end, const std::vector<DataVector> &rows, const std::vector<DataVector> &originals);
+        void searchRecursive(int node, Query &q, TopKBuffer &best);
+        void searchRadiusRecursive(int node, Query &q, double radius, std::vector<double> &res);
 };
 
 class RPTreeIndex : public TreeIndex {
     public:
+        explicit RPTreeIndex(int leafSize = 100) : TreeIndex(leafSize) {}
         void Maketree(std::vector<DataVector> &dataset) override;
         std::vector<double> searchKNearest(const DataVector &target, int k);
+        std::vector<double> searchRadius(const DataVector &target, double radius);
     private:
-        Node* build(std::vector<DataVector>::iterator begin, std::vector<DataVector>::iterator end);
-        void searchRecursive(Node* node, const DataVector &target, int k, std::priority_queue<double> &pq);
+        int build(std::vector<int>::iterator begin, std::vector<int>::iterator end, const std::vector<DataVector> &rows, const std::vector<DataVector> &originals);
+        void searchRecursive(int node, Query &q, TopKBuffer &best);
+        void searchRadiusRecursive(int node, Query &q, double radius, std::vector<double> &res);
 };
 
 #endif
\ No newline at end of file
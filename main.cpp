@@ -56,9 +56,15 @@ public:
     DataVector& operator[](size_t idx) { return set[idx]; }
 };
 
-int main() {
+int main(int argc, char **argv) {
     std::cout << "=== HNSW k-NN Search ===" << std::endl;
     
+    // --reorder renumbers nodes for memory locality after the build (off by default)
+    bool reorder = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--reorder") reorder = true;
+    }
+    
     std::string filename = "mnist-train.csv";
     std::ifstream testfile(filename);
     if (!testfile.good()) {
@@ -89,6 +95,14 @@ int main() {
     auto buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(buildEnd - start);
     std::cout << "Index built in " << buildTime.count() << " ms" << std::endl;
     
+    if (reorder) {
+        std::cout << "\nReordering nodes for memory locality..." << std::endl;
+        auto reorderStart = std::chrono::high_resolution_clock::now();
+        hnsw.reorderNodes();
+        auto reorderEnd = std::chrono::high_resolution_clock::now();
+        std::cout << "Reordered in " << std::chrono::duration_cast<std::chrono::milliseconds>(reorderEnd - reorderStart).count() << " ms" << std::endl;
+    }
+    
     DataVector testQuery = trainData[100];
     std::cout << "\nSearching for 10 nearest neighbors..." << std::endl;
     
@@ -0,0 +1,125 @@
+// Brute-force comparison tests for KDTreeIndex and RPTreeIndex
+#include "TreeIndex.h"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Gaussian data; the first `strongDims` coordinates get a larger spread so PCA has structure to find
+static std::vector<DataVector> randomData(int n, int dim, int strongDims, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist(0, 1);
+    std::vector<DataVector> data;
+    for (int i = 0; i < n; ++i) {
+        DataVector v(dim);
+        for (int j = 0; j < dim; ++j) v[j] = dist(gen) * (j < strongDims ? 5.0 : 0.2);
+        data.push_back(v);
+    }
+    return data;
+}
+
+static std::vector<double> bruteDistances(const std::vector<DataVector> &data, const DataVector &query) {
+    std::vector<double> d;
+    for (auto &p : data) d.push_back(query.dist(p));
+    std::sort(d.begin(), d.end());
+    return d;
+}
+
+static bool sameDistances(const std::vector<double> &a, const std::vector<double> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::abs(a[i] - b[i]) > 1e-9 * std::max(1.0, b[i])) return false;
+    }
+    return true;
+}
+
+// k-NN and radius results must equal brute force, including a radius that lies exactly on a point
+template <typename Tree>
+static void checkAgainstBruteForce(Tree &tree, const std::vector<DataVector> &data, const std::vector<DataVector> &queries, const std::string &name) {
+    const int k = 10;
+    int knnMismatches = 0, radiusMismatches = 0;
+    for (auto &q : queries) {
+        std::vector<double> all = bruteDistances(data, q);
+        std::vector<double> knn(all.begin(), all.begin() + k);
+        if (!sameDistances(tree.searchKNearest(q, k), knn)) ++knnMismatches;
+
+        double radius = all[30];
+        std::vector<double> inside;
+        for (double d : all) {
+            if (d <= radius) inside.push_back(d);
+        }
+        if (!sameDistances(tree.searchRadius(q, radius), inside)) ++radiusMismatches;
+    }
+    check(knnMismatches == 0, name + " searchKNearest: " + std::to_string(knnMismatches) + " queries differ from brute force");
+    check(radiusMismatches == 0, name + " searchRadius: " + std::to_string(radiusMismatches) + " queries differ from brute force");
+}
+
+static void testExactSearch() {
+    std::vector<DataVector> data = randomData(3000, 20, 20, 1);
+    std::vector<DataVector> queries = randomData(50, 20, 20, 2);
+    for (int i = 0; i < 50; ++i) queries.push_back(data[i * 13]);  // Queries that are indexed points
+
+    for (int leafSize : {16, 100}) {
+        std::string suffix = " (leaf " + std::to_string(leafSize) + ")";
+        KDTreeIndex kd(leafSize);
+        kd.Maketree(data);
+        checkAgainstBruteForce(kd, data, queries, "KD" + suffix);
+
+        RPTreeIndex rp(leafSize);
+        rp.Maketree(data);
+        checkAgainstBruteForce(rp, data, queries, "RP" + suffix);
+    }
+}
+
+static void testPCARerank() {
+    std::vector<DataVector> data = randomData(3000, 40, 6, 3);
+    std::vector<DataVector> queries = randomData(50, 40, 6, 4);
+
+    KDTreeIndex kd(32);
+    kd.enablePCA(6, true);
+    kd.Maketree(data);
+    checkAgainstBruteForce(kd, data, queries, "KD + PCA rerank");
+
+    RPTreeIndex rp(32);
+    rp.enablePCA(6, true);
+    rp.Maketree(data);
+    checkAgainstBruteForce(rp, data, queries, "RP + PCA rerank");
+}
+
+static void testEmptyTree() {
+    std::vector<DataVector> empty;
+    DataVector q(4);
+
+    KDTreeIndex kd;
+    kd.Maketree(empty);
+    check(kd.searchKNearest(q, 5).empty(), "empty KD searchKNearest");
+    check(kd.searchRadius(q, 1.0).empty(), "empty KD searchRadius");
+
+    RPTreeIndex rp;
+    rp.Maketree(empty);
+    check(rp.searchKNearest(q, 5).empty(), "empty RP searchKNearest");
+    check(rp.searchRadius(q, 1.0).empty(), "empty RP searchRadius");
+
+    KDTreeIndex unbuilt;
+    check(unbuilt.searchKNearest(q, 5).empty(), "unbuilt KD searchKNearest");
+}
+
+int main() {
+    testExactSearch();
+    testPCARerank();
+    testEmptyTree();
+
+    if (failures > 0) {
+        std::cerr << failures << " tree test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All tree tests passed" << std::endl;
+    return 0;
+}